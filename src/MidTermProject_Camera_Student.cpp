@@ -1,11 +1,13 @@
 /* INCLUDES FOR THIS PROJECT */
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <vector>
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -15,9 +17,20 @@
 
 #include "dataStructures.h"
 #include "matching2D.hpp"
+#include "perfCounters.hpp"
+#include "frameArena.hpp"
+#include "visSink.hpp"
 
 using namespace std;
 
+// write ratio of two counter values, leave cell empty if a counter was not available
+static void writeRatio(stringstream &ss, double num, double den, const string &sep)
+{
+    if ((num >= 0) && (den > 0))
+        ss << num / den;
+    ss << sep;
+}
+
 // varying parameters: 
 // - detectors      {"SHITOMASI", "HARRIS", "FAST", "BRISK", "ORB", "AKAZE", "SIFT"}
 // - descriptors    {"BRISK", "BRIEF", "ORB", "FREAK", "AKAZE", "SIFT"}
@@ -36,7 +49,8 @@ void saveReport(std::vector<DetectionInfo> &combinationInfo)
         reportFile << "Detector" << sep << "Descriptor" << sep << "Matcher" << sep
             << "DescriptorType" << sep << "Selector" << sep;
 
-        std::vector<std::string> imgInfo = { "numKeypoint", "numKeypointsVehicle", "numKeypointsMatched", "tKeypointDetection", "tKeypointDesc" };
+        std::vector<std::string> imgInfo = { "numKeypoint", "numKeypointsVehicle", "numKeypointsMatched", "tKeypointDetection", "tKeypointDesc",
+            "numFrameAllocs", "numFrameAllocBytes" };
 
         stringstream ss;
         for (int i = 0; i < imgInfo.size(); ++i) {
@@ -48,6 +62,21 @@ void saveReport(std::vector<DetectionInfo> &combinationInfo)
             }
         }
 
+        // profiling mode: derived hardware counter metrics per stage
+        bool bProfile = !combinationInfo[0].perfDetection.empty();
+        std::vector<std::string> perfInfo = { "ipcDetection", "ipcDescription", "ipcMatching",
+            "cacheMissPerKptDetection", "branchMissPerKptDetection", "llcPerL1dLoadDetection",
+            "cacheMissPerKptDescription", "llcPerL1dLoadDescription", "cyclesPerDescriptor" };
+        for (int i = 0; bProfile && i < perfInfo.size(); ++i) {
+            for (int j = 0; j < combinationInfo[0].numKeypoints.size(); ++j) {
+                ss.clear();
+                ss.str("");
+                ss << perfInfo[i] << "_" << j << sep;
+                reportFile << ss.str();
+            }
+        }
+        reportFile << "\n";
+
         // write results for each combination
         for (auto combination : combinationInfo) {
             ss.clear();
@@ -60,6 +89,9 @@ void saveReport(std::vector<DetectionInfo> &combinationInfo)
             for (int j = 0; j < combination.numKeypointsVehicle.size(); ++j)
                 ss << combination.numKeypointsVehicle[j] << sep;
 
+            // matching starts with the second frame, leave cell of first frame empty to stay aligned with header
+            if (combination.numKeypointsMatched.size() < combination.numKeypoints.size())
+                ss << sep;
             for (int j = 0; j < combination.numKeypointsMatched.size(); ++j)
                 ss << combination.numKeypointsMatched[j] << sep;
 
@@ -69,6 +101,41 @@ void saveReport(std::vector<DetectionInfo> &combinationInfo)
             for (int j = 0; j < combination.tKeypointDescription.size(); ++j) 
                 ss << combination.tKeypointDescription[j] << sep;
 
+            for (int j = 0; j < combination.numFrameAllocations.size(); ++j)
+                ss << combination.numFrameAllocations[j] << sep;
+
+            for (int j = 0; j < combination.numFrameAllocatedBytes.size(); ++j)
+                ss << combination.numFrameAllocatedBytes[j] << sep;
+
+            if (bProfile) {
+                const std::vector<PerfSample> &det = combination.perfDetection;
+                const std::vector<PerfSample> &desc = combination.perfDescription;
+                const std::vector<PerfSample> &mat = combination.perfMatching;
+
+                for (int j = 0; j < det.size(); ++j)
+                    writeRatio(ss, det[j].instructions, det[j].cycles, sep);
+                for (int j = 0; j < desc.size(); ++j)
+                    writeRatio(ss, desc[j].instructions, desc[j].cycles, sep);
+                if (mat.size() < det.size())
+                    ss << sep; // no matching for first frame
+                for (int j = 0; j < mat.size(); ++j)
+                    writeRatio(ss, mat[j].instructions, mat[j].cycles, sep);
+
+                for (int j = 0; j < det.size(); ++j)
+                    writeRatio(ss, det[j].cacheMisses, combination.numKeypoints[j], sep);
+                for (int j = 0; j < det.size(); ++j)
+                    writeRatio(ss, det[j].branchMisses, combination.numKeypoints[j], sep);
+                for (int j = 0; j < det.size(); ++j)
+                    writeRatio(ss, det[j].llcLoads, det[j].l1dLoads, sep);
+
+                for (int j = 0; j < desc.size(); ++j)
+                    writeRatio(ss, desc[j].cacheMisses, combination.numDescriptors[j], sep);
+                for (int j = 0; j < desc.size(); ++j)
+                    writeRatio(ss, desc[j].llcLoads, desc[j].l1dLoads, sep);
+                for (int j = 0; j < desc.size(); ++j)
+                    writeRatio(ss, desc[j].cycles, combination.numDescriptors[j], sep);
+            }
+
             ss << "\n";
 
             reportFile << ss.str();
@@ -135,7 +202,41 @@ int main(int argc, const char *argv[])
     // misc
     int dataBufferSize = 2;       // no. of images which are held in memory (ring buffer) at the same time
     vector<DataFrame> dataBuffer; // list of data frames which are held in memory at the same time
-    bool bVis = false;            // visualize results    
+    bool bVis = false;            // visualize results (non-blocking, rendered on a background thread)
+    VisSink::Mode visMode = VisSink::VIS_PNG; // VIS_WINDOW, VIS_VIDEO, VIS_PNG (video / png for headless systems)
+    int visDecimation = 1;        // only visualize every n-th frame
+    bool bProfile = false;        // read hardware performance counters around detector, descriptor and matcher calls
+
+    // sink has to be created before the counters are opened, s.t. its render thread does not inherit them
+    std::unique_ptr<VisSink> visSink;
+    if (bVis)
+        visSink.reset(new VisSink(visMode, "./", visDecimation));
+    VisSink *vis = visSink.get();
+
+    // counters need to be opened before OpenCV spawns its worker threads, so that these are counted as well
+    std::unique_ptr<PerfCounters> perfCounters;
+    if (bProfile)
+    {
+        perfCounters.reset(new PerfCounters());
+        // start OpenCV's worker pool now, after opening the counters
+        cv::parallel_for_(cv::Range(0, std::max(2, cv::getNumThreads())), [](const cv::Range &) {});
+    }
+    PerfCounters *perf = (perfCounters && perfCounters->isAvailable()) ? perfCounters.get() : nullptr;
+
+    // frame-scoped temporaries, sized once for the stream resolution and reused for every frame
+    FrameArena arena;
+    size_t arenaMaxKeypoints = 5000; // expected upper bound of keypoints per frame, buffers grow if exceeded
+    size_t numImages = imgEndIndex - imgStartIndex + 1;
+    dataBuffer.reserve(dataBufferSize);
+
+    // assemble filenames once, s.t. the image loop does not allocate strings
+    vector<string> imgFullFilenames;
+    for (size_t imgIndex = 0; imgIndex < numImages; imgIndex++)
+    {
+        ostringstream imgNumber;
+        imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
+        imgFullFilenames.push_back(imgBasePath + imgPrefix + imgNumber.str() + imgFileType);
+    }
 
     // outer loop over all possible combinations
      
@@ -151,35 +252,68 @@ int main(int argc, const char *argv[])
         // clear Buffer
         dataBuffer.clear();        
 
+        // name visualization output after the combination
+        if (vis)
+            vis->setCombination(it->detector + "_" + it->descriptor + "_" + it->matcherType + "_" + it->selectorType);
+
+        // create detector, extractor and matcher once per combination (SHITOMASI / HARRIS need no detector object)
+        cv::Ptr<cv::FeatureDetector> detector;
+        if ((it->detector.compare("SHITOMASI") != 0) && (it->detector.compare("HARRIS") != 0))
+            detector = createDetector(it->detector);
+        cv::Ptr<cv::DescriptorExtractor> extractor = createExtractor(it->descriptor);
+        cv::Ptr<cv::DescriptorMatcher> matcher = createMatcher(it->descriptorType, it->matcherType);
+
+        // reserve per-frame results, s.t. storing them does not allocate within the image loop
+        it->numKeypoints.reserve(numImages);
+        it->numKeypointsVehicle.reserve(numImages);
+        it->numKeypointsMatched.reserve(numImages);
+        it->numDescriptors.reserve(numImages);
+        it->tKeypointDetection.reserve(numImages);
+        it->tKeypointDescription.reserve(numImages);
+        it->numFrameAllocations.reserve(numImages);
+        it->numFrameAllocatedBytes.reserve(numImages);
+        if (bProfile)
+        {
+            it->perfDetection.reserve(numImages);
+            it->perfDescription.reserve(numImages);
+            it->perfMatching.reserve(numImages);
+        }
+
         /* MAIN LOOP OVER ALL IMAGES */
 
         for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex++)
         {
             /* LOAD IMAGE INTO BUFFER */
 
-            // assemble filenames for current index
-            ostringstream imgNumber;
-            imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
-            string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+            // count heap allocations of this frame only, not the setup of the combination
+            arena.beginFrame();
+
+            if (vis)
+                vis->nextFrame();
 
-            // load image from file and convert to grayscale
-            cv::Mat img, imgGray;
+            // filename for current index
+            const string &imgFullFilename = imgFullFilenames[imgIndex];
+
+            // load image from file
+            cv::Mat img;
             img = cv::imread(imgFullFilename);
-            cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
 
             //// STUDENT ASSIGNMENT
             //// TASK MP.1 -> replace the following code with ring buffer of size dataBufferSize
             //// --> DONE
 
             // if dataBuffer has reached its maximum size before appending new image,
-            // delete first element
+            // recycle first element (keeps image, keypoint and match buffers of the oldest frame)
             if (dataBuffer.size() == dataBufferSize)
-                dataBuffer.erase(dataBuffer.begin());
+                std::rotate(dataBuffer.begin(), dataBuffer.begin() + 1, dataBuffer.end());
+            else
+                dataBuffer.push_back(DataFrame());
 
-            // push image into data frame buffer
-            DataFrame frame;
-            frame.cameraImg = imgGray;
-            dataBuffer.push_back(frame);
+            // convert image to grayscale directly into data frame buffer
+            DataFrame &frame = dataBuffer.back();
+            cv::cvtColor(img, frame.cameraImg, cv::COLOR_BGR2GRAY);
+            cv::Mat &imgGray = frame.cameraImg;
+            arena.reserve(imgGray.size(), arenaMaxKeypoints);
 
             //// EOF STUDENT ASSIGNMENT
             cout << "#1 : LOAD IMAGE INTO BUFFER done" << endl;
@@ -187,7 +321,8 @@ int main(int argc, const char *argv[])
             /* DETECT IMAGE KEYPOINTS */
 
             // extract 2D keypoints from current image
-            vector<cv::KeyPoint> keypoints; // create empty feature list for current image
+            vector<cv::KeyPoint> &keypoints = frame.keypoints; // detect directly into feature list of current frame
+            keypoints.clear();
             //string detectorType = "SHITOMASI";
             //string detectorType = "SIFT";         // checked "SHITOMASI", "HARRIS", "FAST", "BRISK", "ORB", "AKAZE", "SIFT"           
             //string detectorType = combination.detector;
@@ -202,11 +337,11 @@ int main(int argc, const char *argv[])
             double t = 0.;
             if (detectorType.compare("SHITOMASI") == 0)
             {
-                t = detKeypointsShiTomasi(keypoints, imgGray, false);
+                t = detKeypointsShiTomasi(keypoints, imgGray, bVis, perf, &arena, vis);
             }
             else if (detectorType.compare("HARRIS") == 0)
             {
-                t = detKeypointsHarris(keypoints, imgGray, false);
+                t = detKeypointsHarris(keypoints, imgGray, bVis, perf, &arena, vis);
             }
             else if ((detectorType.compare("FAST") == 0)
                 | (detectorType.compare("BRISK") == 0)
@@ -214,7 +349,7 @@ int main(int argc, const char *argv[])
                 | (detectorType.compare("AKAZE") == 0)
                 | (detectorType.compare("SIFT") == 0))
             {
-                t = detKeypointsModern(keypoints, imgGray, detectorType, false);
+                t = detKeypointsModern(keypoints, imgGray, detectorType, bVis, perf, vis, detector);
             }
             else
             {
@@ -225,6 +360,8 @@ int main(int argc, const char *argv[])
             // store information
             //combination.tKeypointDetection.push_back(t);
             it->tKeypointDetection.push_back(t);
+            if (bProfile) // no sample if detector was not recognized
+                it->perfDetection.push_back((perf && (t != -9999)) ? perf->sample() : PerfSample());
 
             //// EOF STUDENT ASSIGNMENT
 
@@ -242,14 +379,9 @@ int main(int argc, const char *argv[])
             cv::Rect vehicleRect(535, 180, 180, 150);
             if (bFocusOnVehicle)
             {
-                std::vector<cv::KeyPoint> keypointsRect;
-                for (auto i : keypoints) {
-                    if (vehicleRect.contains(i.pt))
-                    {
-                        keypointsRect.push_back(i);
-                    }
-                }
-                keypoints = keypointsRect;
+                // filter in place, no copy of the keypoint list needed
+                keypoints.erase(std::remove_if(keypoints.begin(), keypoints.end(),
+                    [&vehicleRect](const cv::KeyPoint &kpt) { return !vehicleRect.contains(kpt.pt); }), keypoints.end());
             }
             // store information
             //combination.numKeypointsVehicle.push_back(static_cast<int>(keypoints.size()));
@@ -271,8 +403,7 @@ int main(int argc, const char *argv[])
                 cout << " NOTE: Keypoints have been limited!" << endl;
             }
 
-            // push keypoints and descriptor for current frame to end of data buffer
-            (dataBuffer.end() - 1)->keypoints = keypoints;
+            // keypoints have been detected directly into the current frame at the end of data buffer
             cout << "#2 : DETECT KEYPOINTS done" << endl;
 
             /* EXTRACT KEYPOINT DESCRIPTORS */
@@ -282,20 +413,20 @@ int main(int argc, const char *argv[])
             //// -> BRIEF, ORB, FREAK, AKAZE, SIFT
             //// --> DONE
 
-            cv::Mat descriptors;
+            cv::Mat &descriptors = frame.descriptors; // compute directly into current frame
             //string descriptorType = "SIFT"; // BRISK, BRIEF, ORB, FREAK, AKAZE, SIFT
             //string descriptorType = combination.descriptor;
             string descriptorType = it->descriptor;
             t = 0.;
-            t = descKeypoints((dataBuffer.end() - 1)->keypoints, (dataBuffer.end() - 1)->cameraImg, descriptors, descriptorType);
+            t = descKeypoints((dataBuffer.end() - 1)->keypoints, (dataBuffer.end() - 1)->cameraImg, descriptors, descriptorType, perf, extractor);
             //// EOF STUDENT ASSIGNMENT
 
             // store information
             //combination.tKeypointMatching.push_back(t);
             it->tKeypointDescription.push_back(t);
-
-            // push descriptors for current frame to end of data buffer
-            (dataBuffer.end() - 1)->descriptors = descriptors;
+            it->numDescriptors.push_back(descriptors.rows);
+            if (bProfile) // no sample if descriptor was not recognized
+                it->perfDescription.push_back((perf && (t != -9999)) ? perf->sample() : PerfSample());
 
             cout << "#3 : EXTRACT DESCRIPTORS done" << endl;
 
@@ -304,7 +435,8 @@ int main(int argc, const char *argv[])
 
                 /* MATCH KEYPOINT DESCRIPTORS */
 
-                vector<cv::DMatch> matches;
+                vector<cv::DMatch> &matches = frame.kptMatches; // match directly into current frame
+                matches.clear();
                 //string matcherType = "MAT_FLANN";        // MAT_BF, MAT_FLANN
                 //string descriptorType = "DES_HOG";      // DES_BINARY, DES_HOG
                 //string selectorType = "SEL_NN";         // SEL_NN, SEL_KNN
@@ -322,46 +454,44 @@ int main(int argc, const char *argv[])
                 //// TASK MP.6 -> add KNN match selection and perform descriptor distance ratio filtering with t=0.8 in file matching2D.cpp
                 //// --> DONE
 
-                matchDescriptors((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
+                t = matchDescriptors((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
                     (dataBuffer.end() - 2)->descriptors, (dataBuffer.end() - 1)->descriptors,
-                    matches, descriptorType, matcherType, selectorType);
+                    matches, descriptorType, matcherType, selectorType, perf, &arena, matcher);
 
                 //// EOF STUDENT ASSIGNMENT
 
                 // store information
                 //combination.numKeypointsMatched.push_back(static_cast<int>(matches.size()));
                 it->numKeypointsMatched.push_back(static_cast<int>(matches.size()));
-
-                // store matches in current data frame
-                (dataBuffer.end() - 1)->kptMatches = matches;
+                if (bProfile) // no sample if matcher was not recognized
+                    it->perfMatching.push_back((perf && (t != -9999)) ? perf->sample() : PerfSample());
 
                 cout << "#4 : MATCH KEYPOINT DESCRIPTORS done" << endl;
 
-                // visualize matches between current and previous image
-                bVis = false;
-                if (bVis)
+                // visualize matches between current and previous image (rendered by visualization sink)
+                if (bVis && vis && vis->isActive())
                 {
-                    cv::Mat matchImg = ((dataBuffer.end() - 1)->cameraImg).clone();
-                    cv::drawMatches((dataBuffer.end() - 2)->cameraImg, (dataBuffer.end() - 2)->keypoints,
-                        (dataBuffer.end() - 1)->cameraImg, (dataBuffer.end() - 1)->keypoints,
-                        matches, matchImg,
-                        cv::Scalar::all(-1), cv::Scalar::all(-1),
-                        vector<char>(), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-
-                    string windowName = "Matching keypoints between two camera images";
-                    cv::namedWindow(windowName, 7);
-                    cv::imshow(windowName, matchImg);
-                    cout << "Press key to continue to next image" << endl;
-                    cv::waitKey(0); // wait for key to be pressed
+                    vis->postMatches("Matching keypoints between two camera images",
+                        (dataBuffer.end() - 2)->cameraImg, (dataBuffer.end() - 2)->keypoints,
+                        (dataBuffer.end() - 1)->cameraImg, (dataBuffer.end() - 1)->keypoints, matches);
                 }
-                bVis = false;
             }
 
+            // end of frame: release temporaries and record heap allocations of this frame
+            arena.reset();
+            it->numFrameAllocations.push_back(arena.numAllocations());
+            it->numFrameAllocatedBytes.push_back(arena.numBytesAllocated());
+            cout << "#5 : FRAME done with " << arena.numAllocations() << " heap allocations, " << arena.numBytesAllocated() << " bytes" << endl;
+
         } // eof loop over all images
     
     }       // eof loop over combinations
 
     saveReport(combinationInfo);
 
+    if (vis)
+        cout << "Visualization: " << vis->numPosted() << " snapshots posted, " << vis->numDropped() << " dropped, "
+            << 1000 * vis->tPost() << " ms spent on processing thread" << endl;
+
     return 0;
 }
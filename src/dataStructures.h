@@ -14,6 +14,13 @@ struct DataFrame { // represents the available sensor information at the same ti
     std::vector<cv::DMatch> kptMatches; // keypoint matches between previous and current frame
 };
 
+struct PerfSample { // hardware counter readings for a single pipeline stage call (-1 if counter not available)
+
+    long long cycles = -1, instructions = -1;
+    long long cacheMisses = -1, branchMisses = -1;
+    long long l1dLoads = -1, llcLoads = -1;
+};
+
 // - detectors      ["SHITOMASI", "HARRIS", "FAST", "BRISK", "ORB", "AKAZE", "SIFT"]
 // - descriptors    ["BRISK", "BRIEF", "ORB", "FREAK", "AKAZE", "SIFT"]
 // - matcherType    ["MAT_BF", "MAT_FLANN"]
@@ -21,8 +28,11 @@ struct DataFrame { // represents the available sensor information at the same ti
 // - selectorType   ["SEL_NN", "SEL_KNN"]
 struct DetectionInfo {
     std::string detector, descriptor, descriptorType, matcherType, selectorType;
-    std::vector<int> numKeypoints, numKeypointsVehicle, numKeypointsMatched; 
+    std::vector<int> numKeypoints, numKeypointsVehicle, numKeypointsMatched, numDescriptors;
     std::vector<double> tKeypointDetection, tKeypointDescription;
+    std::vector<size_t> numFrameAllocations;     // heap allocations of the processing thread per frame (see frameArena.hpp)
+    std::vector<size_t> numFrameAllocatedBytes;  // heap bytes allocated by the processing thread per frame
+    std::vector<PerfSample> perfDetection, perfDescription, perfMatching; // only filled in profiling mode
 };
 
 #endif /* dataStructures_h */
@@ -0,0 +1,99 @@
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+#include "frameArena.hpp"
+
+using namespace std;
+
+// heap allocations of the calling thread since the last FrameArena::reset() on that thread
+static thread_local size_t threadAllocs = 0;
+static thread_local size_t threadAllocBytes = 0;
+
+// replaced global allocation functions, counting every allocation made through new
+void *operator new(std::size_t size)
+{
+    ++threadAllocs;
+    threadAllocBytes += size;
+
+    if (size == 0)
+        size = 1;
+    while (true)
+    {
+        if (void *p = std::malloc(size))
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return ::operator new(size); }
+    catch (...) { return nullptr; }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return ::operator new(size); }
+    catch (...) { return nullptr; }
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+FrameArena::FrameArena() : maxRows(0), frameAllocs(0), frameBytes(0)
+{
+}
+
+void FrameArena::reserve(cv::Size imgSize, size_t maxKeypoints)
+{
+    // cv::Mat::create only allocates if size or type differ
+    mats[MAT_HARRIS_RESPONSE].create(imgSize, CV_32FC1);
+    mats[MAT_HARRIS_NORM].create(imgSize, CV_32FC1);
+    mats[MAT_HARRIS_NORM_SCALED].create(imgSize, CV_8UC1);
+
+    cornerBuf.reserve(maxKeypoints);
+    knnMatchBuf.reserve(maxKeypoints);
+    maxRows = max(maxRows, static_cast<int>(maxKeypoints));
+}
+
+cv::Mat FrameArena::rows(MatSlot slot, int numRows, int cols, int type)
+{
+    // pooled buffer is only reallocated if the row layout changes (other descriptor) or it is too small
+    cv::Mat &buf = mats[slot];
+    if ((buf.cols != cols) || (buf.type() != type) || (buf.rows < numRows))
+        buf.create(max(numRows, maxRows), cols, type);
+
+    return buf.rowRange(0, numRows);
+}
+
+void FrameArena::beginFrame()
+{
+    threadAllocs = 0;
+    threadAllocBytes = 0;
+}
+
+void FrameArena::reset()
+{
+    // elements are trivially destructible, memory is kept
+    cornerBuf.clear();
+
+    frameAllocs = threadAllocs;
+    frameBytes = threadAllocBytes;
+    threadAllocs = 0;
+    threadAllocBytes = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef frameArena_hpp
+#define frameArena_hpp
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Frame-scoped pool for the temporaries of keypoint detection and matching.
+// Buffers are sized once for the stream resolution and keep their memory between frames, s.t. steady-state frames
+// do not allocate. beginFrame() / reset() are called at the start / end of each frame; both run in constant time and
+// do not free any pooled buffer.
+//
+// Allocation statistics: frameArena.cpp replaces the global operator new, which counts every heap allocation of the
+// calling thread. beginFrame() zeroes the counts, reset() takes the counts of the finished frame (setup work between
+// frames is not charged to any frame). These include all std containers, strings and
+// cv::Ptr objects created by our code or by OpenCV on the processing thread. Not counted are cv::Mat pixel buffers
+// (allocated by cv::fastMalloc) and allocations of OpenCV worker threads.
+class FrameArena
+{
+public:
+    enum MatSlot { MAT_HARRIS_RESPONSE, MAT_HARRIS_NORM, MAT_HARRIS_NORM_SCALED, MAT_FLANN_SOURCE, MAT_FLANN_REF, MAT_NUM };
+
+    FrameArena();
+
+    void reserve(cv::Size imgSize, size_t maxKeypoints); // preallocate buffers, no-op once sized for the stream
+    void beginFrame();                                   // start of frame: zero allocation counters
+    void reset();                                        // end of frame: update statistics, keep memory
+
+    cv::Mat &mat(MatSlot slot) { return mats[slot]; }
+    cv::Mat rows(MatSlot slot, int numRows, int cols, int type); // first numRows rows of a pooled buffer, e.g. for descriptors
+    std::vector<cv::Point2f> &corners() { return cornerBuf; }
+
+    // only the outer list keeps its capacity: OpenCV's knnMatch allocates every inner vector anew,
+    // callers clear the list right before knnMatch
+    std::vector<std::vector<cv::DMatch> > &knnMatches() { return knnMatchBuf; }
+
+    size_t numAllocations() const { return frameAllocs; }     // heap allocations during last frame
+    size_t numBytesAllocated() const { return frameBytes; }   // heap bytes allocated during last frame
+
+private:
+    cv::Mat mats[MAT_NUM];
+    std::vector<cv::Point2f> cornerBuf;
+    std::vector<std::vector<cv::DMatch> > knnMatchBuf;
+    int maxRows;
+
+    size_t frameAllocs;
+    size_t frameBytes;
+};
+
+#endif /* frameArena_hpp */
@@ -17,13 +17,30 @@
 #include <opencv2/xfeatures2d/nonfree.hpp>
 
 #include "dataStructures.h"
+#include "perfCounters.hpp"
+#include "frameArena.hpp"
+#include "visSink.hpp"
 
 
-double detKeypointsHarris(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false);
-double detKeypointsShiTomasi(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false);
-double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis=false);
-double descKeypoints(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string descriptorType);
-void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
-                      std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType);
+// optional perf: hardware counters are read around the detector / descriptor / matcher call only (see perfCounters.hpp)
+// optional arena: temporaries are taken from the frame arena instead of being allocated per call (see frameArena.hpp)
+// bVis: keypoints are posted to the non-blocking visualization sink vis, if given (see visSink.hpp)
+double detKeypointsHarris(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false, PerfCounters *perf=nullptr, FrameArena *arena=nullptr,
+                          VisSink *vis=nullptr);
+double detKeypointsShiTomasi(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false, PerfCounters *perf=nullptr, FrameArena *arena=nullptr,
+                             VisSink *vis=nullptr);
+double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis=false, PerfCounters *perf=nullptr,
+                          VisSink *vis=nullptr, cv::Ptr<cv::FeatureDetector> detector=cv::Ptr<cv::FeatureDetector>());
+double descKeypoints(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string descriptorType, PerfCounters *perf=nullptr,
+                     cv::Ptr<cv::DescriptorExtractor> extractor=cv::Ptr<cv::DescriptorExtractor>());
+double matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                        std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType,
+                        PerfCounters *perf=nullptr, FrameArena *arena=nullptr, cv::Ptr<cv::DescriptorMatcher> matcher=cv::Ptr<cv::DescriptorMatcher>());
+
+// detector, extractor and matcher objects are expensive to construct; create them once per combination and pass them
+// to the functions above (these create their own object per call if none is given)
+cv::Ptr<cv::FeatureDetector> createDetector(std::string detectorType);
+cv::Ptr<cv::DescriptorExtractor> createExtractor(std::string descriptorType);
+cv::Ptr<cv::DescriptorMatcher> createMatcher(std::string descriptorType, std::string matcherType);
 
 #endif /* matching2D_hpp */
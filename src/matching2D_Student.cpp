@@ -3,9 +3,8 @@
 
 using namespace std;
 
-// Find best matches for keypoints in two camera images based on several matching methods
-void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
-                      std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType)
+// Create matcher for given descriptor type, returns empty pointer if matcher type is not recognized
+cv::Ptr<cv::DescriptorMatcher> createMatcher(std::string descriptorType, std::string matcherType)
 {
     // configure matcher
     bool crossCheck = false;
@@ -20,17 +19,56 @@ void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::Key
     }
     else if (matcherType.compare("MAT_FLANN") == 0)
     {
-        // introduced after error occured with MAT_FLANN and DESC_BRISK
-        if (descRef.type() != CV_32F) { descRef.convertTo(descRef, CV_32F); }
-        if (descSource.type() != CV_32F) { descSource.convertTo(descSource, CV_32F); }
         matcher = cv::FlannBasedMatcher::create();
     }
+    else
+    {
+        cout << "Did not recognize matcher type." << endl;
+    }
+
+    return matcher;
+}
+
+// Find best matches for keypoints in two camera images based on several matching methods
+double matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                        std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType,
+                        PerfCounters *perf, FrameArena *arena, cv::Ptr<cv::DescriptorMatcher> matcher)
+{
+    // create matcher if none is given by caller
+    if (!matcher)
+        matcher = createMatcher(descriptorType, matcherType);
+    if (!matcher)
+    {
+        cout << "No matcher. Returning." << endl;
+        return -9999;
+    }
+
+    // introduced after error occured with MAT_FLANN and DESC_BRISK
+    // FLANN needs float descriptors, convert into arena buffers s.t. the frame descriptors keep their type
+    cv::Mat descSourceMatch = descSource, descRefMatch = descRef;
+    if (matcherType.compare("MAT_FLANN") == 0)
+    {
+        if (descSource.type() != CV_32F)
+        {
+            if (arena)
+                descSourceMatch = arena->rows(FrameArena::MAT_FLANN_SOURCE, descSource.rows, descSource.cols, CV_32F);
+            descSource.convertTo(descSourceMatch, CV_32F);
+        }
+        if (descRef.type() != CV_32F)
+        {
+            if (arena)
+                descRefMatch = arena->rows(FrameArena::MAT_FLANN_REF, descRef.rows, descRef.cols, CV_32F);
+            descRef.convertTo(descRefMatch, CV_32F);
+        }
+    }
 
     // perform matching task
+    if (perf) perf->start();
+    double t = (double)cv::getTickCount();
     if (selectorType.compare("SEL_NN") == 0)
     {                 
         // nearest neighbor (best match)
-        matcher->match(descSource, descRef, matches); // Finds the best match for each descriptor in descSource
+        matcher->match(descSourceMatch, descRefMatch, matches); // Finds the best match for each descriptor in descSource
     }
     else if (selectorType.compare("SEL_KNN") == 0)
     { 
@@ -38,8 +76,10 @@ void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::Key
         int k = 2;
         
         // need to store in own knn_matches
-        std::vector< std::vector<cv::DMatch> > knn_matches;        
-        matcher->knnMatch(descSource, descRef, knn_matches, k);
+        std::vector< std::vector<cv::DMatch> > knnMatchesLocal;
+        std::vector< std::vector<cv::DMatch> > &knn_matches = arena ? arena->knnMatches() : knnMatchesLocal;
+        knn_matches.clear(); // drop inner vectors of the previous frame, keep capacity of the outer list
+        matcher->knnMatch(descSourceMatch, descRefMatch, knn_matches, k);
 
         // filter matches using the Lowe's ratio test
         // taken from https://docs.opencv.org/3.4/d5/d6f/tutorial_feature_flann_matcher.html
@@ -53,10 +93,14 @@ void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::Key
         }
 
     }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    if (perf) perf->stop();
+
+    return t;
 }
 
-// Use one of several types of state-of-art descriptors to uniquely identify keypoints
-double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, string descriptorType)
+// Create one of several types of state-of-art descriptors, returns empty pointer if descriptor type is not recognized
+cv::Ptr<cv::DescriptorExtractor> createExtractor(string descriptorType)
 {
     // select appropriate descriptor
     cv::Ptr<cv::DescriptorExtractor> extractor;
@@ -95,21 +139,38 @@ double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &des
     }
     else
     {
-        cout << "Did not recognize keypoint descriptor. Returning." << endl;
+        cout << "Did not recognize keypoint descriptor." << endl;
+    }
+
+    return extractor;
+}
+
+// Use one of several types of state-of-art descriptors to uniquely identify keypoints
+double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, string descriptorType, PerfCounters *perf,
+                     cv::Ptr<cv::DescriptorExtractor> extractor)
+{
+    // create extractor if none is given by caller
+    if (!extractor)
+        extractor = createExtractor(descriptorType);
+    if (!extractor)
+    {
+        cout << "No keypoint descriptor. Returning." << endl;
         return -9999;
     }
 
     // perform feature description
+    if (perf) perf->start();
     double t = (double)cv::getTickCount();
     extractor->compute(img, keypoints, descriptors);
     t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    if (perf) perf->stop();
     cout << descriptorType << " descriptor extraction in " << 1000 * t / 1.0 << " ms" << endl;
 
     return t;
 }
 
 // Detect keypoints in image using the traditional Shi-Thomasi detector
-double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis, PerfCounters *perf, FrameArena *arena, VisSink *vis)
 {
     // compute detector parameters based on image size
     int blockSize = 4;       //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
@@ -121,8 +182,10 @@ double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool
     double k = 0.04;
 
     // Apply corner detection
+    if (perf) perf->start();
     double t = (double)cv::getTickCount();
-    vector<cv::Point2f> corners;
+    vector<cv::Point2f> cornersLocal;
+    vector<cv::Point2f> &corners = arena ? arena->corners() : cornersLocal;
     cv::goodFeaturesToTrack(img, corners, maxCorners, qualityLevel, minDistance, cv::Mat(), blockSize, false, k);
 
     // add corners to result vector
@@ -135,23 +198,19 @@ double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool
         keypoints.push_back(newKeyPoint);
     }
     t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    if (perf) perf->stop();
     cout << "Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;    
 
     // visualize results
-    if (bVis)
+    if (bVis && vis && vis->isActive())
     {
-        cv::Mat visImage = img.clone();
-        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        string windowName = "Shi-Tomasi Corner Detector Results";
-        cv::namedWindow(windowName, 6);
-        imshow(windowName, visImage);
-        cv::waitKey(0);
+        vis->postKeypoints("Shi-Tomasi Corner Detector Results", img, keypoints);
     }
 
     return t;
 }
 
-double detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool bVis)
+double detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool bVis, PerfCounters *perf, FrameArena *arena, VisSink *vis)
 {
     // Detector parameters
     int blockSize = 2;     // for every pixel, a blockSize  blockSize neighborhood is considered
@@ -159,10 +218,13 @@ double detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bo
     int minResponse = 100; // minimum value for a corner in the 8bit scaled response matrix
     double k = 0.04;       // Harris parameter (see equation for details)
 
-    // Detect Harris corners and normalize output
-    cv::Mat dst, dst_norm, dst_norm_scaled;
-    dst = cv::Mat::zeros(img.size(), CV_32FC1);
+    // Detect Harris corners and normalize output (cornerHarris overwrites every pixel, no need to zero dst)
+    cv::Mat dstLocal, dstNormLocal, dstNormScaledLocal;
+    cv::Mat &dst = arena ? arena->mat(FrameArena::MAT_HARRIS_RESPONSE) : dstLocal;
+    cv::Mat &dst_norm = arena ? arena->mat(FrameArena::MAT_HARRIS_NORM) : dstNormLocal;
+    cv::Mat &dst_norm_scaled = arena ? arena->mat(FrameArena::MAT_HARRIS_NORM_SCALED) : dstNormScaledLocal;
 
+    if (perf) perf->start();
     double t = (double)cv::getTickCount();
     cv::cornerHarris(img, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT);
     cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
@@ -207,30 +269,22 @@ double detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bo
     }     // eof loop over rows
 
     t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    if (perf) perf->stop();
     cout << "Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
 
     // visualize results
-    if (bVis)
+    if (bVis && vis && vis->isActive())
     {
-        // visualize results
-        //string windowName = "Harris Corner Detector Response Matrix";
-        //cv::namedWindow(windowName, 4);
-        //cv::imshow(windowName, dst_norm_scaled);
-        
-        // visualize keypoints
-        string windowName = "Harris Corner Detection Results";
-        cv::namedWindow(windowName, 5);
-        cv::Mat visImage = dst_norm_scaled.clone();
-        cv::drawKeypoints(dst_norm_scaled, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        cv::imshow(windowName, visImage);
-        cv::waitKey(0);
+        // visualize keypoints on response matrix
+        vis->postKeypoints("Harris Corner Detection Results", dst_norm_scaled, keypoints);
         // EOF STUDENT CODE
     }
 
     return t;
 }
 
-double detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, std::string detectorType, bool bVis)
+// Create one of several modern keypoint detectors, returns empty pointer if detector type is not recognized
+cv::Ptr<cv::FeatureDetector> createDetector(std::string detectorType)
 {
     int threshold = 30;                                                              // difference between intensity of the central pixel and pixels of a circle around this pixel
     bool bNMS = true;                                                                // perform non-maxima suppression on keypoints
@@ -263,25 +317,34 @@ double detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, st
     }
 
     else {
-        cout << "DetectorType not recognized. Returning." << endl;
+        cout << "DetectorType not recognized." << endl;
+    }
+
+    return detector;
+}
+
+double detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, std::string detectorType, bool bVis, PerfCounters *perf, VisSink *vis,
+                          cv::Ptr<cv::FeatureDetector> detector)
+{
+    // create detector if none is given by caller
+    if (!detector)
+        detector = createDetector(detectorType);
+    if (!detector)
+    {
+        cout << "No detector. Returning." << endl;
         return -9999;
     }
 
+    if (perf) perf->start();
     double t = (double)cv::getTickCount();
     detector->detect(img, keypoints);
     t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    if (perf) perf->stop();
     cout << detectorType << " with n= " << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
 
-    if (bVis == true)
+    if (bVis && vis && vis->isActive())
     {
-        cv::Mat visImage;
-        visImage = img.clone();
-        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        stringstream windowName;
-        windowName << detectorType << " Results";
-        cv::namedWindow(windowName.str(), 2);
-        imshow(windowName.str(), visImage);
-        cv::waitKey(0);
+        vis->postKeypoints(detectorType + " Results", img, keypoints);
     }
 
     return t;
@@ -0,0 +1,119 @@
+#include <iostream>
+#include "perfCounters.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+// glibc offers no wrapper for perf_event_open
+static int openCounter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;        // also count OpenCV worker threads spawned after opening
+    attr.exclude_kernel = 1; // allowed with perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static uint64_t cacheConfig(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+}
+#endif
+
+PerfCounters::PerfCounters() : bAvailable(false)
+{
+    for (int i = 0; i < CNT_NUM; ++i)
+        fds[i] = -1;
+
+#ifdef __linux__
+    fds[CNT_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[CNT_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[CNT_CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[CNT_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[CNT_L1D_LOADS] = openCounter(PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D));
+    fds[CNT_LLC_LOADS] = openCounter(PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_LL));
+
+    for (int i = 0; i < CNT_NUM; ++i)
+        bAvailable |= (fds[i] >= 0);
+
+    if (!bAvailable)
+        cout << "Hardware performance counters not available (" << strerror(errno) << "). Profiling disabled." << endl;
+#else
+    cout << "Hardware performance counters only supported on Linux. Profiling disabled." << endl;
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (int i = 0; i < CNT_NUM; ++i)
+        if (fds[i] >= 0)
+            close(fds[i]);
+#endif
+}
+
+void PerfCounters::start()
+{
+#ifdef __linux__
+    for (int i = 0; i < CNT_NUM; ++i)
+    {
+        if (fds[i] < 0)
+            continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void PerfCounters::stop()
+{
+    long long values[CNT_NUM];
+    for (int i = 0; i < CNT_NUM; ++i)
+        values[i] = -1;
+
+#ifdef __linux__
+    for (int i = 0; i < CNT_NUM; ++i)
+        if (fds[i] >= 0)
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int i = 0; i < CNT_NUM; ++i)
+    {
+        // value, time enabled, time running
+        uint64_t buf[3];
+        if (fds[i] < 0 || read(fds[i], buf, sizeof(buf)) != sizeof(buf))
+            continue;
+
+        // scale counts if the kernel had to multiplex counters
+        if (buf[2] == 0)
+            values[i] = 0;
+        else if (buf[2] < buf[1])
+            values[i] = static_cast<long long>(static_cast<double>(buf[0]) * buf[1] / buf[2]);
+        else
+            values[i] = static_cast<long long>(buf[0]);
+    }
+#endif
+
+    lastSample.cycles = values[CNT_CYCLES];
+    lastSample.instructions = values[CNT_INSTRUCTIONS];
+    lastSample.cacheMisses = values[CNT_CACHE_MISSES];
+    lastSample.branchMisses = values[CNT_BRANCH_MISSES];
+    lastSample.l1dLoads = values[CNT_L1D_LOADS];
+    lastSample.llcLoads = values[CNT_LLC_LOADS];
+}
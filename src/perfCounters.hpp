@@ -0,0 +1,35 @@
+#ifndef perfCounters_hpp
+#define perfCounters_hpp
+
+#include <string>
+
+#include "dataStructures.h"
+
+// Reads Linux hardware performance counters (perf_event_open) around a single pipeline stage.
+// Each counter is opened on its own, so a counter which is not supported by the CPU / VM is simply reported as -1.
+// If no counter can be opened at all (e.g. perf_event_paranoid or seccomp inside containers), isAvailable() is false
+// and the pipeline keeps running without profiling information.
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    bool isAvailable() const { return bAvailable; }
+
+    void start();                                 // reset and enable all counters
+    void stop();                                  // disable all counters and store readings in sample()
+    const PerfSample &sample() const { return lastSample; }
+
+private:
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    enum { CNT_CYCLES, CNT_INSTRUCTIONS, CNT_CACHE_MISSES, CNT_BRANCH_MISSES, CNT_L1D_LOADS, CNT_LLC_LOADS, CNT_NUM };
+
+    int fds[CNT_NUM];
+    bool bAvailable;
+    PerfSample lastSample;
+};
+
+#endif /* perfCounters_hpp */
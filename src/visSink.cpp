@@ -0,0 +1,183 @@
+#include <iostream>
+#include <cctype>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "visSink.hpp"
+
+using namespace std;
+
+// window names contain blanks, use a file system friendly version for video / png output
+static string fileName(const string &name)
+{
+    string file = name;
+    for (auto &c : file)
+        if (!isalnum(static_cast<unsigned char>(c)))
+            c = '_';
+    return file;
+}
+
+VisSink::VisSink(Mode mode, std::string outputPath, int decimation, size_t queueSize, double fps)
+    : mode(mode), outputPath(outputPath), decimation(max(1, decimation)), queueSize(max<size_t>(1, queueSize)), fps(fps),
+      frameIndex(-1), posted(0), dropped(0), tPosting(0.), bStop(false), bFailed(false)
+{
+    renderThread = std::thread(&VisSink::run, this);
+}
+
+VisSink::~VisSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        bStop = true;
+    }
+    queueCond.notify_one();
+    renderThread.join();
+}
+
+void VisSink::setCombination(const std::string &combination)
+{
+    this->combination = combination;
+}
+
+void VisSink::nextFrame()
+{
+    ++frameIndex;
+}
+
+bool VisSink::isActive() const
+{
+    return (frameIndex >= 0) && (frameIndex % decimation == 0);
+}
+
+void VisSink::postKeypoints(const std::string &name, const cv::Mat &img, const std::vector<cv::KeyPoint> &keypoints)
+{
+    if (!isActive())
+        return;
+
+    double t = (double)cv::getTickCount();
+    VisItem item;
+    item.name = combination.empty() ? name : combination + " " + name;
+    item.frameIndex = frameIndex;
+    item.bMatches = false;
+    img.copyTo(item.imgSource);
+    item.kPtsSource = keypoints;
+    push(std::move(item));
+    tPosting += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+}
+
+void VisSink::postMatches(const std::string &name, const cv::Mat &imgSource, const std::vector<cv::KeyPoint> &kPtsSource,
+                          const cv::Mat &imgRef, const std::vector<cv::KeyPoint> &kPtsRef, const std::vector<cv::DMatch> &matches)
+{
+    if (!isActive())
+        return;
+
+    double t = (double)cv::getTickCount();
+    VisItem item;
+    item.name = combination.empty() ? name : combination + " " + name;
+    item.frameIndex = frameIndex;
+    item.bMatches = true;
+    imgSource.copyTo(item.imgSource);
+    imgRef.copyTo(item.imgRef);
+    item.kPtsSource = kPtsSource;
+    item.kPtsRef = kPtsRef;
+    item.matches = matches;
+    push(std::move(item));
+    tPosting += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+}
+
+void VisSink::push(VisItem &&item)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        // lossy: drop oldest snapshot instead of waiting for the render thread
+        if (queue.size() >= queueSize)
+        {
+            queue.pop_front();
+            ++dropped;
+        }
+        queue.push_back(std::move(item));
+        ++posted;
+    }
+    queueCond.notify_one();
+}
+
+void VisSink::run()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true)
+    {
+        queueCond.wait(lock, [this] { return bStop || !queue.empty(); });
+        if (queue.empty())
+            break; // stop requested and all snapshots rendered
+
+        VisItem item = std::move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+        // a failing debug output must not take down the processing pipeline
+        if (!bFailed)
+        {
+            try
+            {
+                render(item);
+            }
+            catch (const cv::Exception &e)
+            {
+                cout << "Visualization failed, sink disabled: " << e.what() << endl;
+                bFailed = true;
+            }
+            catch (const std::exception &e)
+            {
+                cout << "Visualization failed, sink disabled: " << e.what() << endl;
+                bFailed = true;
+            }
+        }
+        lock.lock();
+    }
+    lock.unlock();
+
+    // finish video files
+    writers.clear();
+}
+
+void VisSink::render(const VisItem &item)
+{
+    cv::Mat visImage;
+    if (item.bMatches)
+    {
+        cv::drawMatches(item.imgSource, item.kPtsSource, item.imgRef, item.kPtsRef, item.matches, visImage,
+            cv::Scalar::all(-1), cv::Scalar::all(-1), vector<char>(), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+    }
+    else
+    {
+        cv::drawKeypoints(item.imgSource, item.kPtsSource, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+    }
+
+    if (mode == VIS_WINDOW)
+    {
+        cv::imshow(item.name, visImage);
+        cv::waitKey(1); // only process window events, do not wait for a key
+    }
+    else if (mode == VIS_VIDEO)
+    {
+        cv::VideoWriter &writer = writers[item.name];
+        if (!writer.isOpened())
+        {
+            string file = outputPath + fileName(item.name) + ".avi";
+            if (!writer.open(file, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, visImage.size()))
+                cout << "Could not open video file " << file << endl;
+        }
+        if (writer.isOpened())
+            writer.write(visImage);
+    }
+    else if (mode == VIS_PNG)
+    {
+        ostringstream file;
+        file << outputPath << fileName(item.name) << "_" << setfill('0') << setw(6) << item.frameIndex << ".png";
+        cv::imwrite(file.str(), visImage);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef visSink_hpp
+#define visSink_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/videoio.hpp>
+
+// Asynchronous visualization of keypoint and match overlays.
+// The processing thread only posts snapshots (image + keypoints / matches) into a lossy bounded queue; drawing and
+// output (window, video or png sequence) happen on a background thread, all HighGUI calls included. If the render
+// thread falls behind, the oldest snapshot is dropped instead of blocking the processing thread.
+// Snapshots own their pixels: posted images are copied, s.t. the caller may reuse its buffers right away.
+// Callers should check isActive() before building names or snapshots, s.t. decimated frames cost nothing.
+// If rendering or writing fails (e.g. no display for VIS_WINDOW), the error is logged and the sink is disabled.
+class VisSink
+{
+public:
+    enum Mode { VIS_WINDOW, VIS_VIDEO, VIS_PNG };
+
+    VisSink(Mode mode, std::string outputPath = "./", int decimation = 1, size_t queueSize = 4, double fps = 10.0);
+    ~VisSink(); // renders remaining snapshots, then stops the render thread
+
+    void setCombination(const std::string &combination); // prefix for window / file names of following snapshots
+    void nextFrame();      // call once per processed frame, used for decimation
+    bool isActive() const; // true if snapshots of the current frame are accepted
+
+    void postKeypoints(const std::string &name, const cv::Mat &img, const std::vector<cv::KeyPoint> &keypoints);
+    void postMatches(const std::string &name, const cv::Mat &imgSource, const std::vector<cv::KeyPoint> &kPtsSource,
+                     const cv::Mat &imgRef, const std::vector<cv::KeyPoint> &kPtsRef, const std::vector<cv::DMatch> &matches);
+
+    int numPosted() const { return posted; }
+    int numDropped() const { return dropped; }
+    double tPost() const { return tPosting; } // time spent posting on the processing thread [s]
+
+private:
+    struct VisItem {
+        std::string name;
+        int frameIndex;
+        bool bMatches;
+        cv::Mat imgSource, imgRef;
+        std::vector<cv::KeyPoint> kPtsSource, kPtsRef;
+        std::vector<cv::DMatch> matches;
+    };
+
+    VisSink(const VisSink &) = delete;
+    VisSink &operator=(const VisSink &) = delete;
+
+    void push(VisItem &&item);
+    void run();
+    void render(const VisItem &item);
+
+    Mode mode;
+    std::string outputPath;
+    int decimation;
+    size_t queueSize;
+    double fps;
+
+    // processing thread only
+    std::string combination;
+    int frameIndex;
+    int posted, dropped;
+    double tPosting;
+
+    // shared between processing and render thread
+    std::deque<VisItem> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    bool bStop;
+
+    // render thread only
+    std::map<std::string, cv::VideoWriter> writers;
+    bool bFailed;
+    std::thread renderThread;
+};
+
+#endif /* visSink_hpp */